@@ -1,6 +1,9 @@
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <libavcodec/avcodec.h>
@@ -14,12 +17,22 @@
 void sleep_ms(int milliseconds) {
     Sleep(milliseconds);
 }
+
+double now_ms() {
+    return (double)GetTickCount64();
+}
 #else
 #include <unistd.h>
 
 void sleep_ms(int milliseconds) {
     usleep(milliseconds * 1000);
 }
+
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
 #endif
 
 #define check_ffmpeg_err(context)  \
@@ -41,6 +54,8 @@ void init_ncurses() {
     }
     cbreak();
     noecho();
+    nodelay(stdscr, TRUE);
+    keypad(stdscr, TRUE);
     start_color();
     curs_set(0);
     for (int i = 0; i < 256; i++) {
@@ -61,45 +76,84 @@ typedef struct {
     int audio_idx;
     AVStream *audio_stream;
     const AVCodec *audio_codec;
+
+    /* Set before encoder_init_from_file to trade probing accuracy for
+     * startup time. */
+    int fast_start;
+    /* Optional; once it becomes non-zero, blocked opens and reads abort. */
+    atomic_int *stop;
 } Encoder;
 
+int encoder_interrupt(void *opaque) {
+    return atomic_load((atomic_int *)opaque);
+}
+
+/* Probe limits for fast start: bytes read and microseconds analyzed. */
+#define FAST_START_PROBESIZE "65536"
+#define FAST_START_ANALYZEDURATION "100000"
+
+/* Whether the container header alone describes a decodable video stream,
+ * as it does for mp4 or mkv, so stream probing can be skipped. */
+int encoder_header_has_video(const Encoder *e) {
+    for (unsigned i = 0; i < e->in_avfc->nb_streams; i++) {
+        const AVCodecParameters *par = e->in_avfc->streams[i]->codecpar;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO && par->codec_id != AV_CODEC_ID_NONE &&
+            par->width > 0 && par->height > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int encoder_init_from_file(Encoder *e, const char *fname) {
     int ret;
+    AVDictionary *fmt_opts = NULL;
 
-    ret = avformat_open_input(&e->in_avfc, fname, NULL, NULL);
-    if (ret < 0) return ret;
+    e->in_avfc = avformat_alloc_context();
+    if (!e->in_avfc) return AVERROR(ENOMEM);
+    if (e->stop) e->in_avfc->interrupt_callback = (AVIOInterruptCB){encoder_interrupt, e->stop};
 
-    ret = avformat_find_stream_info(e->in_avfc, NULL);
+    if (e->fast_start) {
+        av_dict_set(&fmt_opts, "probesize", FAST_START_PROBESIZE, 0);
+        av_dict_set(&fmt_opts, "analyzeduration", FAST_START_ANALYZEDURATION, 0);
+    }
+    ret = avformat_open_input(&e->in_avfc, fname, NULL, &fmt_opts);
+    av_dict_free(&fmt_opts);
     if (ret < 0) return ret;
 
-    e->nb_streams = e->in_avfc->nb_streams;
+    if (!e->fast_start || !encoder_header_has_video(e)) {
+        ret = avformat_find_stream_info(e->in_avfc, NULL);
+        if (ret < 0) return ret;
+    }
 
-    for (int i = 0; i < e->nb_streams; i++) {
-        enum AVMediaType codec_type = e->in_avfc->streams[i]->codecpar->codec_type;
+    e->nb_streams = e->in_avfc->nb_streams;
 
-        if (codec_type != AVMEDIA_TYPE_AUDIO && codec_type != AVMEDIA_TYPE_VIDEO) {
-            continue;
-        }
+    /* Pick one video stream the same way in both modes, so cover art and
+     * other secondary streams never win, and open only its decoder. */
+    ret = av_find_best_stream(e->in_avfc, AVMEDIA_TYPE_VIDEO, -1, -1, &e->video_codec, 0);
+    if (ret < 0) return ret;
+    e->video_idx = ret;
+    e->video_stream = e->in_avfc->streams[ret];
 
-        if (codec_type == AVMEDIA_TYPE_VIDEO) {
-            e->video_idx = i;
-            e->video_stream = e->in_avfc->streams[i];
-            e->video_codec = avcodec_find_decoder(e->video_stream->codecpar->codec_id);
+    e->video_codec_context = avcodec_alloc_context3(e->video_codec);
+    if (!e->video_codec_context) return AVERROR(ENOMEM);
+    ret = avcodec_parameters_to_context(e->video_codec_context, e->video_stream->codecpar);
+    if (ret < 0) return ret;
 
-            e->video_codec_context = avcodec_alloc_context3(e->video_codec);
-            ret = avcodec_parameters_to_context(e->video_codec_context, e->video_stream->codecpar);
-            if (ret < 0) return ret;
+    ret = avcodec_open2(e->video_codec_context, e->video_codec, NULL);
+    if (ret < 0) return ret;
 
-            ret = avcodec_open2(e->video_codec_context, e->video_codec, NULL);
-            if (ret < 0) return ret;
-        } else if (codec_type == AVMEDIA_TYPE_AUDIO) {
-            e->audio_idx = i;
-            e->audio_stream = e->in_avfc->streams[i];
-            e->audio_codec = avcodec_find_decoder(e->in_avfc->streams[i]->codecpar->codec_id);
+    /* Nothing decodes audio yet; fast start skips even looking it up. */
+    if (!e->fast_start) {
+        ret = av_find_best_stream(e->in_avfc, AVMEDIA_TYPE_AUDIO, -1, e->video_idx,
+                                  &e->audio_codec, 0);
+        if (ret >= 0) {
+            e->audio_idx = ret;
+            e->audio_stream = e->in_avfc->streams[ret];
         }
     }
 
-    return ret;
+    return 0;
 }
 
 typedef struct {
@@ -109,122 +163,1193 @@ typedef struct {
 } Point;
 
 void encoder_free(Encoder *e) {
+    avcodec_free_context(&e->video_codec_context);
     avformat_close_input(&e->in_avfc);
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        usage();
-        return 1;
-    }
+/* const char ascii_chars[] = " .:-=+*#%@"; */
+const char ascii_chars[] =
+    " .'`^\",:;Il!i><~+_-?][}{1)(|/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$";
+const int num_chars = sizeof(ascii_chars) - 1;
 
-    const char *ifname = argv[1];
+typedef struct {
+    int x;
+    int y;
+    int w;
+    int h;
+} Rect;
 
-    init_ncurses();
+/* Picture area left after the decoder's cropping fields. libavcodec applies
+ * them itself by default, in which case they are zero here. */
+Rect frame_visible_rect(const AVFrame *frame) {
+    return (Rect){
+        .x = frame->crop_left,
+        .y = frame->crop_top,
+        .w = frame->width - frame->crop_left - frame->crop_right,
+        .h = frame->height - frame->crop_top - frame->crop_bottom,
+    };
+}
 
-    int ret = 0;
-    const char *err_context = "";
+/* Fits a region of interest, relative to the visible area, inside it. An
+ * empty region selects the whole visible area. */
+Rect roi_clamp(Rect roi, Rect visible) {
+    if (roi.w <= 0 || roi.h <= 0) return (Rect){0, 0, visible.w, visible.h};
+    if (roi.w > visible.w) roi.w = visible.w;
+    if (roi.h > visible.h) roi.h = visible.h;
+    if (roi.x < 0) roi.x = 0;
+    if (roi.y < 0) roi.y = 0;
+    if (roi.x > visible.w - roi.w) roi.x = visible.w - roi.w;
+    if (roi.y > visible.h - roi.h) roi.y = visible.h - roi.h;
+    return roi;
+}
 
-    Encoder e = {0};
-    ret = encoder_init_from_file(&e, ifname);
-    check_ffmpeg_err("encoder_init_from_file");
+/* Pans and zooms the region of interest: arrows or hjkl move it, + and -
+ * zoom, 0 resets to the full picture. Returns whether the key was used. */
+int roi_handle_key(Rect *roi, int key, Rect visible) {
+    Rect r = roi_clamp(*roi, visible);
+    int step_x = r.w / 10 > 0 ? r.w / 10 : 1;
+    int step_y = r.h / 10 > 0 ? r.h / 10 : 1;
 
-    AVFrame *frame = av_frame_alloc();
-    AVPacket *packet = av_packet_alloc();
+    switch (key) {
+    case KEY_LEFT:
+    case 'h':
+        r.x -= step_x;
+        break;
+    case KEY_RIGHT:
+    case 'l':
+        r.x += step_x;
+        break;
+    case KEY_UP:
+    case 'k':
+        r.y -= step_y;
+        break;
+    case KEY_DOWN:
+    case 'j':
+        r.y += step_y;
+        break;
+    case '+':
+    case '=':
+        r.x += r.w / 10;
+        r.y += r.h / 10;
+        r.w -= r.w / 5;
+        r.h -= r.h / 5;
+        break;
+    case '-':
+        r.x -= r.w / 8;
+        r.y -= r.h / 8;
+        r.w += r.w / 4;
+        r.h += r.h / 4;
+        break;
+    case '0':
+        r = (Rect){0};
+        break;
+    default:
+        return 0;
+    }
+    *roi = roi_clamp(r, visible);
+    return 1;
+}
+
+/* Box-averages the pixels of roi (in frame coordinates) into the grid. Only
+ * the rows and columns inside roi are read. When zoomed in past one pixel
+ * per cell, neighbouring cells share the nearest pixel. */
+void frame_to_points(const AVFrame *frame, Rect roi, Point *points, int cols, int lines) {
+    const uint8_t *luma = frame->data[0];
+    const uint8_t *cb = frame->data[1];
+    const uint8_t *cr = frame->data[2];
+
+    for (int y = 0; y < lines; y++) {
+        int y0 = roi.y + y * roi.h / lines;
+        int y1 = roi.y + (y + 1) * roi.h / lines;
+        if (y1 <= y0) y1 = y0 + 1;
+
+        for (int x = 0; x < cols; x++) {
+            int x0 = roi.x + x * roi.w / cols;
+            int x1 = roi.x + (x + 1) * roi.w / cols;
+            if (x1 <= x0) x1 = x0 + 1;
 
-    /* const char ascii_chars[] = " .:-=+*#%@"; */
-    const char ascii_chars[] =
-        " .'`^\",:;Il!i><~+_-?][}{1)(|/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$";
-    int num_chars = sizeof(ascii_chars) - 1;
-
-    Point *points = malloc(LINES * COLS * sizeof(Point));
-
-    double frame_ms =
-        1000.0 * e.video_stream->avg_frame_rate.den / e.video_stream->avg_frame_rate.num;
-
-    while (av_read_frame(e.in_avfc, packet) >= 0) {
-        if (packet->stream_index == e.video_idx) {
-            ret = avcodec_send_packet(e.video_codec_context, packet);
-            check_ffmpeg_err("avcodec_send_packet");
-
-            while (ret >= 0) {
-                ret = avcodec_receive_frame(e.video_codec_context, frame);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                    ret = 0;
-                    break;
-                } else if (ret < 0) {
-                    check_ffmpeg_err("avcodec_receive_frame");
-                    break;
+            int y_sum = 0;
+            int u_sum = 0;
+            int v_sum = 0;
+
+            for (int py = y0; py < y1; py++) {
+                const uint8_t *row = luma + py * frame->linesize[0];
+                for (int px = x0; px < x1; px++) {
+                    y_sum += row[px];
                 }
+            }
 
-                clock_t start = clock();
-                int box_width = frame->width / COLS;
-                int box_height = frame->height / LINES;
-
-                for (int y = 0; y < LINES; y++) {
-                    for (int x = 0; x < COLS; x++) {
-                        int y_sum = 0;
-                        int u_sum = 0;
-                        int v_sum = 0;
-
-                        int uv_count = 0;
-
-                        for (int by = 0; by < box_height; by++) {
-                            int y_offset = (y * box_height + by) * frame->width;
-                            for (int bx = 0; bx < box_width; bx++) {
-                                int idx = y_offset + (x * box_width + bx);
-                                y_sum += frame->data[0][idx];
-
-                                if (by % 2 == 0 && bx % 2 == 0) {
-                                    int uv_x = (x * box_width + bx) / 2;
-                                    int uv_y = (y * box_height + by) / 2;
-
-                                    u_sum += frame->data[1][uv_y * (frame->width / 2) + uv_x];
-                                    v_sum += frame->data[2][uv_y * (frame->width / 2) + uv_x];
-                                    uv_count += 1;
-                                }
-                            }
-                        }
-
-                        points[y * COLS + x] = (Point){
-                            .y = y_sum / (box_width * box_height),
-                            .u = u_sum / uv_count,
-                            .v = v_sum / uv_count,
-                        };
-                    }
+            int uv_y0 = y0 / 2;
+            int uv_y1 = (y1 + 1) / 2;
+            int uv_x0 = x0 / 2;
+            int uv_x1 = (x1 + 1) / 2;
+            for (int py = uv_y0; py < uv_y1; py++) {
+                const uint8_t *u_row = cb + py * frame->linesize[1];
+                const uint8_t *v_row = cr + py * frame->linesize[2];
+                for (int px = uv_x0; px < uv_x1; px++) {
+                    u_sum += u_row[px];
+                    v_sum += v_row[px];
                 }
+            }
+
+            int uv_count = (uv_y1 - uv_y0) * (uv_x1 - uv_x0);
+            points[y * cols + x] = (Point){
+                .y = y_sum / ((y1 - y0) * (x1 - x0)),
+                .u = u_sum / uv_count,
+                .v = v_sum / uv_count,
+            };
+        }
+    }
+}
+
+/* Temporal filter over the Point grid. Each channel is smoothed per cell
+ * with an exponential moving average (8.8 fixed point), and the displayed
+ * value only follows it once it has drifted past a hysteresis margin, so
+ * pixel noise no longer flips glyphs between neighbouring ramp entries.
+ * A jump in the luma histogram between frames is taken as a scene cut and
+ * resets the filter so cuts are not smeared. */
+#define SMOOTH_WEIGHT 96 /* weight of the new sample, out of 256 */
+#define LUMA_HYSTERESIS 6
+#define CHROMA_HYSTERESIS 8
+#define HIST_BINS 32
+#define SCENE_CUT_PERCENT 40
+
+typedef struct {
+    int nb_cells;
+    int32_t *avg;
+    Point *held;
+    uint32_t hist[HIST_BINS];
+    int primed;
+    long nb_cuts;
+} TemporalFilter;
+
+int temporal_filter_init(TemporalFilter *t, int cols, int lines) {
+    *t = (TemporalFilter){.nb_cells = cols * lines};
+    t->avg = malloc((size_t)t->nb_cells * 3 * sizeof(int32_t));
+    t->held = malloc((size_t)t->nb_cells * sizeof(Point));
+    return t->avg && t->held ? 0 : -1;
+}
+
+void temporal_filter_free(TemporalFilter *t) {
+    free(t->avg);
+    free(t->held);
+    t->avg = NULL;
+    t->held = NULL;
+}
+
+/* Returns whether the luma histogram moved by more than SCENE_CUT_PERCENT
+ * of its mass since the previous frame. */
+int temporal_filter_scene_cut(TemporalFilter *t, const Point *points) {
+    uint32_t hist[HIST_BINS] = {0};
+    for (int i = 0; i < t->nb_cells; i++) {
+        hist[points[i].y * HIST_BINS / 256]++;
+    }
+
+    long diff = 0;
+    for (int i = 0; i < HIST_BINS; i++) {
+        diff += labs((long)hist[i] - (long)t->hist[i]);
+    }
+    memcpy(t->hist, hist, sizeof(hist));
+
+    /* diff counts every moved cell twice, once leaving and once entering a bin. */
+    return diff * 100 > 2L * t->nb_cells * SCENE_CUT_PERCENT;
+}
+
+uint8_t temporal_filter_hold(uint8_t held, int32_t avg, int margin) {
+    int v = (avg + 128) >> 8;
+    return abs(v - held) > margin ? v : held;
+}
+
+/* Filters points in place. */
+void temporal_filter_apply(TemporalFilter *t, Point *points) {
+    int cut = temporal_filter_scene_cut(t, points);
+
+    if (cut || !t->primed) {
+        for (int i = 0; i < t->nb_cells; i++) {
+            t->avg[i * 3 + 0] = points[i].y << 8;
+            t->avg[i * 3 + 1] = points[i].u << 8;
+            t->avg[i * 3 + 2] = points[i].v << 8;
+            t->held[i] = points[i];
+        }
+        if (t->primed) t->nb_cuts++;
+        t->primed = 1;
+        return;
+    }
+
+    for (int i = 0; i < t->nb_cells; i++) {
+        int32_t *avg = &t->avg[i * 3];
+        avg[0] += ((points[i].y << 8) - avg[0]) * SMOOTH_WEIGHT / 256;
+        avg[1] += ((points[i].u << 8) - avg[1]) * SMOOTH_WEIGHT / 256;
+        avg[2] += ((points[i].v << 8) - avg[2]) * SMOOTH_WEIGHT / 256;
+
+        Point *held = &t->held[i];
+        held->y = temporal_filter_hold(held->y, avg[0], LUMA_HYSTERESIS);
+        held->u = temporal_filter_hold(held->u, avg[1], CHROMA_HYSTERESIS);
+        held->v = temporal_filter_hold(held->v, avg[2], CHROMA_HYSTERESIS);
+        points[i] = *held;
+    }
+}
+
+/* Maps a point to its ramp glyph and 256-color palette index. */
+char point_to_glyph(Point p, int *color) {
+    int c = p.y - 16;
+    int d = p.u - 128;
+    int e = p.v - 128;
+
+    int r = (298 * c + 409 * e + 128) >> 8;
+    int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
+    int b = (298 * c + 516 * d + 128) >> 8;
+
+    r = (r < 0) ? 0 : (r > 255) ? 255 : r;
+    g = (g < 0) ? 0 : (g > 255) ? 255 : g;
+    b = (b < 0) ? 0 : (b > 255) ? 255 : b;
+
+    *color = (r / 32 * 36) + (g / 32 * 6) + (b / 32) + 16;
+    return ascii_chars[p.y * num_chars / 256];
+}
+
+/* Draws the grid with its top-left corner at (top, left); the caller
+ * refreshes the screen. */
+void render_ncurses(const Point *points, int cols, int lines, int top, int left) {
+    for (int y = 0; y < lines; y++) {
+        for (int x = 0; x < cols; x++) {
+            int color;
+            char ch = point_to_glyph(points[y * cols + x], &color);
+            move(top + y, left + x);
+            attron(COLOR_PAIR(color + 1));
+            addch(ch);
+            attroff(COLOR_PAIR(color + 1));
+        }
+    }
+}
+
+/* Buffered writer: collects output in a large buffer and hands it to the
+ * file in few big writes instead of one per glyph. */
+#define WRITER_BUF_SIZE (1 << 20)
+
+typedef struct {
+    FILE *f;
+    char *buf;
+    size_t len;
+    int err;
+} Writer;
+
+int writer_init(Writer *w) {
+    w->buf = malloc(WRITER_BUF_SIZE);
+    w->len = 0;
+    w->err = 0;
+    return w->buf ? 0 : -1;
+}
+
+void writer_flush(Writer *w) {
+    if (w->len > 0 && w->f && fwrite(w->buf, 1, w->len, w->f) != w->len) {
+        w->err = 1;
+    }
+    w->len = 0;
+}
+
+void writer_write(Writer *w, const void *data, size_t n) {
+    if (w->len + n > WRITER_BUF_SIZE) writer_flush(w);
+    if (n > WRITER_BUF_SIZE) {
+        if (w->f && fwrite(data, 1, n, w->f) != n) w->err = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+void writer_putc(Writer *w, char c) {
+    if (w->len == WRITER_BUF_SIZE) writer_flush(w);
+    w->buf[w->len++] = c;
+}
+
+void writer_free(Writer *w) {
+    free(w->buf);
+    w->buf = NULL;
+}
+
+typedef enum {
+    OUTPUT_LIVE,
+    OUTPUT_ASCIICAST,
+    OUTPUT_ANSI,
+    OUTPUT_TEXT,
+} OutputFormat;
+
+typedef struct {
+    OutputFormat format;
+    const char *ofname;
+    int cols;
+    int lines;
+
+    Writer w;
+    char *frame_buf;
+    long nb_frames;
+
+    /* Last emitted (color << 8 | glyph) per cell and the terminal's current
+     * color, so ANSI frames only redraw the cells that changed. */
+    uint32_t *cells;
+    int cur_color;
+    long nb_cells;
+    long nb_changed;
+} Exporter;
+
+/* Renders one frame as ANSI escapes into x->frame_buf, returns its length.
+ * Cells that look the same as in the previous frame are skipped. */
+size_t exporter_ansi_frame(Exporter *x, const Point *points) {
+    char *buf = x->frame_buf;
+    size_t len = 0;
+    int cur_y = -1;
+    int cur_x = -1;
+
+    for (int y = 0; y < x->lines; y++) {
+        for (int xx = 0; xx < x->cols; xx++) {
+            int i = y * x->cols + xx;
+            int color;
+            char ch = point_to_glyph(points[i], &color);
+            uint32_t cell = (uint32_t)color << 8 | (unsigned char)ch;
+            if (cell == x->cells[i]) continue;
+            x->cells[i] = cell;
+            x->nb_changed++;
+
+            if (y != cur_y || xx != cur_x) {
+                len += sprintf(buf + len, "\x1b[%d;%dH", y + 1, xx + 1);
+            }
+            if (color != x->cur_color) {
+                len += sprintf(buf + len, "\x1b[38;5;%dm", color);
+                x->cur_color = color;
+            }
+            buf[len++] = ch;
+            cur_y = y;
+            cur_x = xx + 1 < x->cols ? xx + 1 : -1;
+        }
+    }
+    x->nb_cells += (long)x->cols * x->lines;
+    return len;
+}
+
+size_t ansi_frame_max_size(int cols, int lines) {
+    /* Cursor move, "\x1b[38;5;NNNm" and the glyph, for every cell. */
+    return (size_t)cols * lines * 24 + 16;
+}
+
+void writer_json_escaped(Writer *w, const char *s, size_t n) {
+    char esc[8];
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            writer_putc(w, '\\');
+            writer_putc(w, c);
+        } else if (c == '\n') {
+            writer_write(w, "\\n", 2);
+        } else if (c == '\r') {
+            writer_write(w, "\\r", 2);
+        } else if (c < 0x20) {
+            writer_write(w, esc, sprintf(esc, "\\u%04x", c));
+        } else {
+            writer_putc(w, c);
+        }
+    }
+}
+
+/* Sets up buffers only. Without an output path, text frames are spooled
+ * back to back into w.f instead of one file each, which is how the
+ * parallel export collects a chunk before stitching. */
+int exporter_init(Exporter *x, OutputFormat format, const char *ofname, int cols, int lines) {
+    x->format = format;
+    x->ofname = ofname;
+    x->cols = cols;
+    x->lines = lines;
+    x->nb_frames = 0;
+    x->w.f = NULL;
+
+    if (writer_init(&x->w) < 0) return -1;
+    x->frame_buf = malloc(ansi_frame_max_size(cols, lines));
+    if (!x->frame_buf) return -1;
+
+    x->cells = malloc((size_t)cols * lines * sizeof(uint32_t));
+    if (!x->cells) return -1;
+    memset(x->cells, 0xff, (size_t)cols * lines * sizeof(uint32_t));
+    x->cur_color = -1;
+    x->nb_cells = 0;
+    x->nb_changed = 0;
+    return 0;
+}
+
+int exporter_open(Exporter *x, OutputFormat format, const char *ofname, int cols, int lines) {
+    if (exporter_init(x, format, ofname, cols, lines) < 0) return -1;
+    if (format == OUTPUT_TEXT) return 0;
+
+    x->w.f = fopen(ofname, "wb");
+    if (!x->w.f) return -1;
+    /* Our own buffer already batches the writes. */
+    setvbuf(x->w.f, NULL, _IONBF, 0);
+
+    if (format == OUTPUT_ASCIICAST) {
+        char header[128];
+        int n = snprintf(header, sizeof(header),
+                         "{\"version\": 2, \"width\": %d, \"height\": %d}\n", cols, lines);
+        writer_write(&x->w, header, n);
+    } else if (format == OUTPUT_ANSI) {
+        writer_write(&x->w, "\x1b[2J", 4);
+    }
+    return 0;
+}
+
+size_t text_frame_size(int cols, int lines) {
+    return (size_t)(cols + 1) * lines;
+}
+
+void text_frame(const Point *points, int cols, int lines, char *buf) {
+    for (int y = 0; y < lines; y++) {
+        for (int x = 0; x < cols; x++) {
+            int color;
+            *buf++ = point_to_glyph(points[y * cols + x], &color);
+        }
+        *buf++ = '\n';
+    }
+}
+
+int exporter_save_text_frame(Exporter *x, const char *buf, size_t len) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s-%06ld.txt", x->ofname, x->nb_frames);
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+
+    int err = fwrite(buf, 1, len, f) != len;
+    if (fclose(f) != 0) err = 1;
+    x->nb_frames++;
+    return err ? -1 : 0;
+}
+
+/* Writes one frame; t is the presentation time in seconds. */
+int exporter_write_frame(Exporter *x, const Point *points, double t) {
+    if (x->format == OUTPUT_ASCIICAST) {
+        char prefix[64];
+        size_t len = exporter_ansi_frame(x, points);
+        writer_write(&x->w, prefix, sprintf(prefix, "[%.6f, \"o\", \"", t));
+        writer_json_escaped(&x->w, x->frame_buf, len);
+        writer_write(&x->w, "\"]\n", 3);
+    } else if (x->format == OUTPUT_ANSI) {
+        size_t len = exporter_ansi_frame(x, points);
+        writer_write(&x->w, x->frame_buf, len);
+    } else if (x->format == OUTPUT_TEXT) {
+        size_t len = text_frame_size(x->cols, x->lines);
+        text_frame(points, x->cols, x->lines, x->frame_buf);
+        if (!x->ofname) {
+            writer_write(&x->w, x->frame_buf, len);
+        } else {
+            return exporter_save_text_frame(x, x->frame_buf, len);
+        }
+    }
+
+    x->nb_frames++;
+    return x->w.err ? -1 : 0;
+}
+
+/* Appends the frames spooled by a chunk exporter, in large blocks. */
+int exporter_append(Exporter *x, Exporter *chunk) {
+    writer_flush(&chunk->w);
+    if (chunk->w.err || fseek(chunk->w.f, 0, SEEK_SET) != 0) return -1;
+
+    if (x->format == OUTPUT_TEXT) {
+        size_t len = text_frame_size(x->cols, x->lines);
+        while (fread(x->frame_buf, 1, len, chunk->w.f) == len) {
+            if (exporter_save_text_frame(x, x->frame_buf, len) < 0) return -1;
+        }
+        return 0;
+    }
+
+    size_t n;
+    writer_flush(&x->w);
+    while ((n = fread(x->w.buf, 1, WRITER_BUF_SIZE, chunk->w.f)) > 0) {
+        x->w.len = n;
+        writer_flush(&x->w);
+    }
+    x->nb_frames += chunk->nb_frames;
+    x->nb_cells += chunk->nb_cells;
+    x->nb_changed += chunk->nb_changed;
+    return x->w.err ? -1 : 0;
+}
+
+int exporter_close(Exporter *x) {
+    int err = 0;
+    if (x->format == OUTPUT_ANSI && x->ofname) writer_write(&x->w, "\x1b[0m\r\n", 6);
+    if (x->w.f) {
+        writer_flush(&x->w);
+        if (fclose(x->w.f) != 0) x->w.err = 1;
+        x->w.f = NULL;
+    }
+    err = x->w.err;
+    writer_free(&x->w);
+    free(x->frame_buf);
+    x->frame_buf = NULL;
+    free(x->cells);
+    x->cells = NULL;
+    return err ? -1 : 0;
+}
+
+#define MAX_INPUTS 16
+
+typedef struct {
+    const char *ifname;
+    const char *inputs[MAX_INPUTS];
+    int nb_inputs;
+    OutputFormat format;
+    const char *ofname;
+    int cols;
+    int lines;
+    int jobs;
+    int smooth;
+    Rect crop;
+    int fast_start;
+} Options;
+
+int parse_options(Options *o, int argc, char **argv) {
+    *o = (Options){.format = OUTPUT_LIVE, .cols = 80, .lines = 24, .jobs = 1};
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-f") == 0 && val) {
+            if (strcmp(val, "asciicast") == 0) {
+                o->format = OUTPUT_ASCIICAST;
+            } else if (strcmp(val, "ansi") == 0) {
+                o->format = OUTPUT_ANSI;
+            } else if (strcmp(val, "text") == 0) {
+                o->format = OUTPUT_TEXT;
+            } else {
+                fprintf(stderr, "Unknown export format: %s\n", val);
+                return -1;
+            }
+            i++;
+        } else if (strcmp(arg, "-o") == 0 && val) {
+            o->ofname = val;
+            i++;
+        } else if (strcmp(arg, "-s") == 0 && val) {
+            if (sscanf(val, "%dx%d", &o->cols, &o->lines) != 2 || o->cols <= 0 ||
+                o->lines <= 0) {
+                fprintf(stderr, "Invalid size: %s\n", val);
+                return -1;
+            }
+            i++;
+        } else if (strcmp(arg, "-j") == 0 && val) {
+            o->jobs = atoi(val);
+            if (o->jobs <= 0) {
+                fprintf(stderr, "Invalid job count: %s\n", val);
+                return -1;
+            }
+            i++;
+        } else if (strcmp(arg, "-c") == 0 && val) {
+            Rect *c = &o->crop;
+            if (sscanf(val, "%d,%d,%d,%d", &c->x, &c->y, &c->w, &c->h) != 4 || c->w <= 0 ||
+                c->h <= 0) {
+                fprintf(stderr, "Invalid crop: %s\n", val);
+                return -1;
+            }
+            i++;
+        } else if (strcmp(arg, "-F") == 0) {
+            o->fast_start = 1;
+        } else if (strcmp(arg, "-t") == 0) {
+            o->smooth = 1;
+        } else if (arg[0] == '-' || o->nb_inputs == MAX_INPUTS) {
+            return -1;
+        } else {
+            o->inputs[o->nb_inputs++] = arg;
+        }
+    }
+
+    if (o->nb_inputs == 0) return -1;
+    o->ifname = o->inputs[0];
+    if (o->nb_inputs > 1 && o->format != OUTPUT_LIVE) {
+        fprintf(stderr, "Several inputs are only supported for live playback\n");
+        return -1;
+    }
+    if (o->format != OUTPUT_LIVE && !o->ofname) {
+        fprintf(stderr, "Export needs an output path (-o)\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Decodes the video frames with start_pts <= pts < end_pts, handing each to
+ * on_frame. Stops early when on_frame returns a negative value. */
+typedef int (*FrameCallback)(AVFrame *frame, void *ctx);
+
+int encoder_decode(Encoder *e, AVFrame *frame, AVPacket *packet, int64_t start_pts,
+                   int64_t end_pts, FrameCallback on_frame, void *ctx) {
+    int ret;
+    int draining = 0;
+
+    while (!draining) {
+        if (av_read_frame(e->in_avfc, packet) < 0) {
+            draining = 1;
+            ret = avcodec_send_packet(e->video_codec_context, NULL);
+        } else if (packet->stream_index == e->video_idx) {
+            ret = avcodec_send_packet(e->video_codec_context, packet);
+            av_packet_unref(packet);
+        } else {
+            av_packet_unref(packet);
+            continue;
+        }
+        if (ret < 0) return ret;
+
+        while (1) {
+            ret = avcodec_receive_frame(e->video_codec_context, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+            if (ret < 0) return ret;
+
+            int64_t pts = frame->best_effort_timestamp;
+            if (pts != AV_NOPTS_VALUE && pts < start_pts) continue;
+            if (pts != AV_NOPTS_VALUE && pts >= end_pts) return 0;
+
+            ret = on_frame(frame, ctx);
+            if (ret < 0) return ret;
+        }
+    }
+    return 0;
+}
+
+/* One cell of the mosaic. The decoder thread renders into its own grid and
+ * publishes it under the lock; the main thread copies it out to draw. */
+typedef struct {
+    const char *ifname;
+    Rect area;
+    Point *points;
+    int fresh;
+    int done;
+    int ret;
+    double last_frame_ms;
+    pthread_mutex_t lock;
+    pthread_t thread;
+} Tile;
+
+/* Per-frame state shared by live playback, export and mosaic tiles. */
+typedef struct {
+    const Options *opts;
+    int cols;
+    int lines;
+    Point *points;
+    Exporter *exporter;
+    TemporalFilter *filter;
+    Rect roi;
+    Tile *tile;
+    atomic_int *stop;
+    double next_frame_ms;
+    int seen_key;
+    double first_frame_ms;
+    double frame_ms;
+    AVRational time_base;
+    int64_t start_pts;
+} Pipeline;
+
+void pipeline_init(Pipeline *p, const Options *opts, Encoder *e, Point *points,
+                   Exporter *exporter, TemporalFilter *filter) {
+    AVStream *st = e->video_stream;
+    /* Live feeds often leave the average rate unset. */
+    AVRational rate = st->avg_frame_rate.num ? st->avg_frame_rate : st->r_frame_rate;
+    if (!rate.num || !rate.den) rate = (AVRational){25, 1};
+
+    *p = (Pipeline){0};
+    p->opts = opts;
+    p->cols = opts->cols;
+    p->lines = opts->lines;
+    p->points = points;
+    p->exporter = exporter;
+    p->filter = filter;
+    p->roi = opts->crop;
+    p->frame_ms = 1000.0 * rate.den / rate.num;
+    p->time_base = st->time_base;
+    p->start_pts = st->start_time != AV_NOPTS_VALUE ? st->start_time : 0;
+}
 
-                double real_elapsed = ((double)(clock() - start)) / CLOCKS_PER_SEC * 1000;
+/* Publishes the tile's grid, then sleeps until the tile's next frame is due
+ * on its own clock, so a slow or stalled input never holds up the others. */
+int tile_on_points(Pipeline *p) {
+    Tile *t = p->tile;
+    double now = now_ms();
 
-                for (int y = 0; y < LINES; y++) {
-                    for (int x = 0; x < COLS; x++) {
-                        Point p = points[y * COLS + x];
+    pthread_mutex_lock(&t->lock);
+    memcpy(t->points, p->points, (size_t)p->cols * p->lines * sizeof(Point));
+    t->fresh = 1;
+    t->last_frame_ms = now;
+    pthread_mutex_unlock(&t->lock);
 
-                        int c = p.y - 16;
-                        int d = p.u - 128;
-                        int e = p.v - 128;
+    /* After a stall, pick the pace back up from now instead of bursting. */
+    if (p->next_frame_ms < now - p->frame_ms) p->next_frame_ms = now;
+    p->next_frame_ms += p->frame_ms;
+    if (p->next_frame_ms > now) sleep_ms(p->next_frame_ms - now);
 
-                        int r = (298 * c + 409 * e + 128) >> 8;
-                        int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-                        int b = (298 * c + 516 * d + 128) >> 8;
+    return atomic_load(p->stop) ? AVERROR_EXIT : 0;
+}
 
-                        r = (r < 0) ? 0 : (r > 255) ? 255 : r;
-                        g = (g < 0) ? 0 : (g > 255) ? 255 : g;
-                        b = (b < 0) ? 0 : (b > 255) ? 255 : b;
+int frame_is_key(const AVFrame *frame) {
+#ifdef AV_FRAME_FLAG_KEY
+    return frame->flags & AV_FRAME_FLAG_KEY;
+#else
+    return frame->key_frame;
+#endif
+}
+
+int pipeline_on_frame(AVFrame *frame, void *ctx) {
+    Pipeline *p = ctx;
+
+    /* When joining a stream mid-GOP, show nothing until a keyframe rather
+     * than the half-decoded frames before it. */
+    if (p->opts->fast_start && !p->seen_key) {
+        if (!frame_is_key(frame)) return 0;
+        p->seen_key = 1;
+    }
+
+    clock_t start = clock();
+    Rect visible = frame_visible_rect(frame);
+    if (!p->exporter && !p->tile) {
+        int key;
+        while ((key = getch()) != ERR) {
+            /* A new view is a cut of its own; don't blend the old one in. */
+            if (roi_handle_key(&p->roi, key, visible) && p->filter) p->filter->primed = 0;
+        }
+    }
+
+    p->roi = roi_clamp(p->roi, visible);
+    Rect roi = p->roi;
+    roi.x += visible.x;
+    roi.y += visible.y;
+    frame_to_points(frame, roi, p->points, p->cols, p->lines);
+    if (p->filter) temporal_filter_apply(p->filter, p->points);
+
+    if (p->tile) return tile_on_points(p);
+
+    if (p->exporter) {
+        double t = frame->best_effort_timestamp != AV_NOPTS_VALUE
+                       ? (frame->best_effort_timestamp - p->start_pts) * av_q2d(p->time_base)
+                       : p->exporter->nb_frames * p->frame_ms / 1000.0;
+        if (exporter_write_frame(p->exporter, p->points, t) < 0) return AVERROR(EIO);
+        if (!p->first_frame_ms) p->first_frame_ms = now_ms();
+        return 0;
+    }
+
+    double real_elapsed = ((double)(clock() - start)) / CLOCKS_PER_SEC * 1000;
+
+    render_ncurses(p->points, p->cols, p->lines, 0, 0);
+    refresh();
+    if (!p->first_frame_ms) p->first_frame_ms = now_ms();
+    sleep_ms(p->frame_ms - real_elapsed);
+    return 0;
+}
 
-                        int char_index = p.y * num_chars / 256;
-                        int color = (r / 32 * 36) + (g / 32 * 6) + (b / 32) + 16;
-                        move(y, x);
-                        attron(COLOR_PAIR(color + 1));
-                        addch(ascii_chars[char_index]);
-                        attroff(COLOR_PAIR(color + 1));
-                    }
+/* A video keyframe: seek_ts is what av_seek_frame expects (a DTS for
+ * index-based demuxers such as mp4), pts is where it sits in display order
+ * and is what chunk boundaries are compared against. */
+typedef struct {
+    int64_t seek_ts;
+    int64_t pts;
+} Keyframe;
+
+int keyframes_push(Keyframe **kfs, int *n, int *cap, Keyframe kf) {
+    if (*n == *cap) {
+        Keyframe *grown = realloc(*kfs, *cap * 2 * sizeof(Keyframe));
+        if (!grown) return AVERROR(ENOMEM);
+        *kfs = grown;
+        *cap *= 2;
+    }
+    (*kfs)[(*n)++] = kf;
+    return 0;
+}
+
+/* Collects the video keyframes, from the demuxer index when the container
+ * has one, otherwise by demuxing (not decoding) the whole file. Index
+ * entries only carry the seek timestamp; their pts is left unset for
+ * keyframe_resolve_pts. last_ts is the latest timestamp seen. */
+int find_keyframes(Encoder *e, Keyframe **kfs, int *nb_kfs, int64_t *last_ts) {
+    int cap = 256;
+    int n = 0;
+    int ret = 0;
+    Keyframe *out = malloc(cap * sizeof(Keyframe));
+    if (!out) return AVERROR(ENOMEM);
+    *last_ts = AV_NOPTS_VALUE;
+
+    int nb_entries = avformat_index_get_entries_count(e->video_stream);
+    for (int i = 0; i < nb_entries && ret >= 0; i++) {
+        const AVIndexEntry *ie = avformat_index_get_entry(e->video_stream, i);
+        if (ie->timestamp > *last_ts || *last_ts == AV_NOPTS_VALUE) *last_ts = ie->timestamp;
+        if (!(ie->flags & AVINDEX_KEYFRAME)) continue;
+        ret = keyframes_push(&out, &n, &cap, (Keyframe){ie->timestamp, AV_NOPTS_VALUE});
+    }
+
+    if (n == 0 && ret >= 0) {
+        AVPacket *packet = av_packet_alloc();
+        while (ret >= 0 && av_read_frame(e->in_avfc, packet) >= 0) {
+            int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            if (packet->stream_index == e->video_idx && pts != AV_NOPTS_VALUE) {
+                if (pts > *last_ts || *last_ts == AV_NOPTS_VALUE) *last_ts = pts;
+                if (packet->flags & AV_PKT_FLAG_KEY) {
+                    ret = keyframes_push(&out, &n, &cap, (Keyframe){dts, pts});
                 }
-                refresh();
-                sleep_ms(frame_ms - real_elapsed);
             }
+            av_packet_unref(packet);
         }
+        av_packet_free(&packet);
+    }
+
+    if (ret < 0) {
+        free(out);
+        return ret;
+    }
+    *kfs = out;
+    *nb_kfs = n;
+    return 0;
+}
+
+/* Fills in the pts of an index keyframe by seeking to it and reading the
+ * first video keyframe packet there. */
+int keyframe_resolve_pts(Encoder *e, Keyframe *kf) {
+    if (kf->pts != AV_NOPTS_VALUE) return 0;
+
+    int ret = av_seek_frame(e->in_avfc, e->video_idx, kf->seek_ts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) return ret;
+
+    AVPacket *packet = av_packet_alloc();
+    while ((ret = av_read_frame(e->in_avfc, packet)) >= 0) {
+        int key = packet->stream_index == e->video_idx && (packet->flags & AV_PKT_FLAG_KEY);
+        if (key) kf->pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
         av_packet_unref(packet);
+        if (key) break;
+    }
+    av_packet_free(&packet);
+    return kf->pts != AV_NOPTS_VALUE ? 0 : AVERROR_INVALIDDATA;
+}
+
+typedef struct {
+    const Options *opts;
+    int64_t seek_ts;
+    int64_t start_pts;
+    int64_t end_pts;
+    Exporter exporter;
+    long nb_cuts;
+    double first_frame_ms;
+    int ret;
+    pthread_t thread;
+} Chunk;
+
+/* Renders one time range with its own demuxer and decoder. The temporal
+ * filter, if any, starts afresh at the range boundary. */
+void *chunk_worker(void *arg) {
+    Chunk *c = arg;
+    const Options *o = c->opts;
+
+    Encoder e = {.fast_start = o->fast_start};
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    Point *points = malloc(o->lines * o->cols * sizeof(Point));
+    TemporalFilter filter = {0};
+
+    c->ret = encoder_init_from_file(&e, o->ifname);
+    if (c->ret >= 0 && o->smooth && temporal_filter_init(&filter, o->cols, o->lines) < 0) {
+        c->ret = AVERROR(ENOMEM);
+    }
+    if (c->ret >= 0 && c->start_pts != INT64_MIN) {
+        c->ret = av_seek_frame(e.in_avfc, e.video_idx, c->seek_ts, AVSEEK_FLAG_BACKWARD);
+    }
+    if (c->ret >= 0) {
+        Pipeline p;
+        pipeline_init(&p, o, &e, points, &c->exporter, o->smooth ? &filter : NULL);
+        c->ret = encoder_decode(&e, frame, packet, c->start_pts, c->end_pts, pipeline_on_frame, &p);
+        c->first_frame_ms = p.first_frame_ms;
+    }
+    c->nb_cuts = filter.nb_cuts;
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    encoder_free(&e);
+    free(points);
+    temporal_filter_free(&filter);
+    return NULL;
+}
+
+/* Splits the file at keyframes into opts->jobs time ranges, renders them
+ * concurrently into temporary files and stitches those in order. The first
+ * chunk's first rendered frame is the output's first frame. */
+int export_parallel(Encoder *e, const Options *opts, Exporter *exporter, long *nb_cuts,
+                    double *first_frame_ms) {
+    Keyframe *kfs;
+    int nb_kfs;
+    int64_t last_ts;
+    int ret = find_keyframes(e, &kfs, &nb_kfs, &last_ts);
+    if (ret < 0) return ret;
+
+    Chunk *chunks = calloc(opts->jobs, sizeof(Chunk));
+    if (!chunks) {
+        free(kfs);
+        return AVERROR(ENOMEM);
+    }
+    int nb_chunks = 0;
+    int64_t first_ts = nb_kfs > 0 ? kfs[0].seek_ts : 0;
+    int64_t span = nb_kfs > 0 ? last_ts - first_ts : 0;
+
+    /* Chunk i starts at the first keyframe past i/jobs of the duration.
+     * Ranges are split on the keyframe's pts, so every frame before it in
+     * display order, open-GOP leading frames included, stays in the
+     * previous chunk. */
+    int k = 0;
+    for (int i = 0; i < opts->jobs && k < nb_kfs; i++) {
+        int64_t target = first_ts + span * i / opts->jobs;
+        while (k < nb_kfs && kfs[k].seek_ts < target) k++;
+        if (k == nb_kfs) break;
+
+        Chunk c = {.opts = opts, .start_pts = INT64_MIN, .end_pts = INT64_MAX};
+        if (nb_chunks > 0) {
+            ret = keyframe_resolve_pts(e, &kfs[k]);
+            if (ret < 0) break;
+            c.seek_ts = kfs[k].seek_ts;
+            c.start_pts = kfs[k].pts;
+            chunks[nb_chunks - 1].end_pts = kfs[k].pts;
+        }
+        chunks[nb_chunks++] = c;
+        k++;
+    }
+    free(kfs);
+    if (ret < 0) {
+        free(chunks);
+        return ret;
+    }
+
+    if (nb_chunks == 0) {
+        chunks[nb_chunks++] = (Chunk){.opts = opts, .start_pts = INT64_MIN, .end_pts = INT64_MAX};
+    }
+
+    int started = 0;
+    for (; started < nb_chunks; started++) {
+        Chunk *c = &chunks[started];
+        if (exporter_init(&c->exporter, opts->format, NULL, opts->cols, opts->lines) < 0 ||
+            !(c->exporter.w.f = tmpfile()) ||
+            pthread_create(&c->thread, NULL, chunk_worker, c) != 0) {
+            exporter_close(&c->exporter);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        Chunk *c = &chunks[i];
+        pthread_join(c->thread, NULL);
+        if (ret >= 0 && c->ret < 0) ret = c->ret;
+        if (i == 0) *first_frame_ms = c->first_frame_ms;
+        *nb_cuts += c->nb_cuts;
+        if (ret >= 0 && exporter_append(exporter, &c->exporter) < 0) ret = AVERROR(EIO);
+        exporter_close(&c->exporter);
+    }
+
+    free(chunks);
+    return ret;
+}
+
+typedef struct {
+    const Options *opts;
+    Tile *tile;
+    atomic_int *stop;
+} TileJob;
+
+void *tile_worker(void *arg) {
+    TileJob *job = arg;
+    const Options *o = job->opts;
+    Tile *t = job->tile;
+    int cols = t->area.w;
+    int lines = t->area.h;
+
+    Encoder e = {.fast_start = o->fast_start, .stop = job->stop};
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    Point *points = malloc((size_t)cols * lines * sizeof(Point));
+    TemporalFilter filter = {0};
+
+    int ret = encoder_init_from_file(&e, t->ifname);
+    if (ret >= 0 && o->smooth && temporal_filter_init(&filter, cols, lines) < 0) {
+        ret = AVERROR(ENOMEM);
+    }
+    if (ret >= 0) {
+        Pipeline p;
+        pipeline_init(&p, o, &e, points, NULL, o->smooth ? &filter : NULL);
+        p.cols = cols;
+        p.lines = lines;
+        p.tile = t;
+        p.stop = job->stop;
+        ret = encoder_decode(&e, frame, packet, INT64_MIN, INT64_MAX, pipeline_on_frame, &p);
+    }
+
+    pthread_mutex_lock(&t->lock);
+    t->done = 1;
+    t->ret = ret == AVERROR_EXIT ? 0 : ret;
+    pthread_mutex_unlock(&t->lock);
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    encoder_free(&e);
+    free(points);
+    temporal_filter_free(&filter);
+    return NULL;
+}
+
+#define MOSAIC_TICK_MS 20
+#define MOSAIC_STALL_MS 2000
+
+/* Plays every input in its own tile of a grid layout. Each tile decodes and
+ * paces itself on its own thread; this thread draws whichever tiles have a
+ * new frame and flushes the screen once per tick. Quits on q or once every
+ * input has ended; quitting also interrupts tiles blocked on I/O. */
+int play_mosaic(const Options *opts, double *first_frame_ms) {
+    int n = opts->nb_inputs;
+    int grid_cols = 1;
+    while (grid_cols * grid_cols < n) grid_cols++;
+    int grid_lines = (n + grid_cols - 1) / grid_cols;
+    int tile_cols = opts->cols / grid_cols;
+    int tile_lines = opts->lines / grid_lines;
+    if (tile_cols < 1 || tile_lines < 1) return AVERROR(EINVAL);
+
+    Tile tiles[MAX_INPUTS] = {0};
+    TileJob jobs[MAX_INPUTS];
+    const char *shown_status[MAX_INPUTS] = {0};
+    Point *shown = malloc((size_t)tile_cols * tile_lines * sizeof(Point));
+    atomic_int stop = 0;
+    int started = 0;
+    int ret = 0;
+
+    for (; started < n; started++) {
+        Tile *t = &tiles[started];
+        t->ifname = opts->inputs[started];
+        t->area = (Rect){
+            .x = started % grid_cols * tile_cols,
+            .y = started / grid_cols * tile_lines,
+            .w = tile_cols,
+            .h = tile_lines,
+        };
+        t->points = malloc((size_t)tile_cols * tile_lines * sizeof(Point));
+        t->last_frame_ms = now_ms();
+        pthread_mutex_init(&t->lock, NULL);
+        jobs[started] = (TileJob){.opts = opts, .tile = t, .stop = &stop};
+        if (!t->points || pthread_create(&t->thread, NULL, tile_worker, &jobs[started]) != 0) {
+            pthread_mutex_destroy(&t->lock);
+            free(t->points);
+            ret = AVERROR(ENOMEM);
+            atomic_store(&stop, 1);
+            break;
+        }
+    }
+
+    while (!atomic_load(&stop)) {
+        int nb_done = 0;
+        int dirty = 0;
+        double now = now_ms();
+
+        for (int i = 0; i < started; i++) {
+            Tile *t = &tiles[i];
+            pthread_mutex_lock(&t->lock);
+            int fresh = t->fresh;
+            int done = t->done;
+            int tile_ret = t->ret;
+            double idle_ms = now - t->last_frame_ms;
+            if (fresh) memcpy(shown, t->points, (size_t)tile_cols * tile_lines * sizeof(Point));
+            t->fresh = 0;
+            pthread_mutex_unlock(&t->lock);
+
+            nb_done += done;
+            if (fresh) {
+                render_ncurses(shown, tile_cols, tile_lines, t->area.y, t->area.x);
+                dirty = 1;
+            }
+            if (fresh && !*first_frame_ms) *first_frame_ms = now_ms();
+
+            const char *status = NULL;
+            if (tile_ret < 0) {
+                status = "[error]";
+            } else if (done) {
+                status = "[ended]";
+            } else if (idle_ms > MOSAIC_STALL_MS) {
+                status = "[stalled]";
+            }
+            if (status && (fresh || status != shown_status[i])) {
+                mvaddnstr(t->area.y, t->area.x, status, t->area.w);
+                dirty = 1;
+            }
+            shown_status[i] = status;
+        }
+
+        if (dirty) refresh();
+        if (getch() == 'q' || nb_done == started) break;
+        sleep_ms(MOSAIC_TICK_MS);
+    }
+
+    atomic_store(&stop, 1);
+    for (int i = 0; i < started; i++) {
+        Tile *t = &tiles[i];
+        pthread_join(t->thread, NULL);
+        if (ret >= 0 && t->ret < 0) ret = t->ret;
+        pthread_mutex_destroy(&t->lock);
+        free(t->points);
+    }
+    free(shown);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    double start_ms = now_ms();
+    Options opts;
+    if (parse_options(&opts, argc, argv) < 0) {
+        usage();
+        return 1;
+    }
+
+    avformat_network_init();
+
+    int live = opts.format == OUTPUT_LIVE;
+    if (live) {
+        init_ncurses();
+        opts.cols = COLS;
+        opts.lines = LINES;
+    }
+
+    int ret = 0;
+    const char *err_context = "";
+
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    Point *points = malloc(opts.lines * opts.cols * sizeof(Point));
+
+    Exporter exporter = {0};
+    TemporalFilter filter = {0};
+    double first_frame_ms = 0;
+
+    Encoder e = {.fast_start = opts.fast_start};
+    if (opts.nb_inputs > 1) {
+        ret = play_mosaic(&opts, &first_frame_ms);
+        check_ffmpeg_err("play_mosaic");
+        goto end;
+    }
+
+    ret = encoder_init_from_file(&e, opts.ifname);
+    check_ffmpeg_err("encoder_init_from_file");
+
+    if (opts.smooth && temporal_filter_init(&filter, opts.cols, opts.lines) < 0) {
+        ret = AVERROR(ENOMEM);
+        check_ffmpeg_err("temporal_filter_init");
+    }
+
+    if (!live && exporter_open(&exporter, opts.format, opts.ofname, opts.cols, opts.lines) < 0) {
+        ret = AVERROR(EIO);
+        check_ffmpeg_err("exporter_open");
+    }
+
+    if (!live && opts.jobs > 1) {
+        ret = export_parallel(&e, &opts, &exporter, &filter.nb_cuts, &first_frame_ms);
+        check_ffmpeg_err("export_parallel");
+    } else {
+        Pipeline p;
+        pipeline_init(&p, &opts, &e, points, live ? NULL : &exporter,
+                      opts.smooth ? &filter : NULL);
+        ret = encoder_decode(&e, frame, packet, INT64_MIN, INT64_MAX, pipeline_on_frame, &p);
+        first_frame_ms = p.first_frame_ms;
+        check_ffmpeg_err("encoder_decode");
     }
 
 end:
@@ -232,9 +1357,29 @@ end:
     av_packet_free(&packet);
     encoder_free(&e);
 
-    endwin();
+    if (live) endwin();
 
     free(points);
+    avformat_network_deinit();
+
+    if (!live && exporter.frame_buf) {
+        if (exporter_close(&exporter) < 0 && ret >= 0) {
+            ret = AVERROR(EIO);
+            err_context = "exporter_close";
+        }
+        double elapsed = now_ms() - start_ms;
+        fprintf(stderr, "Exported %ld frames in %.1f ms (%.1f fps)\n", exporter.nb_frames, elapsed,
+                exporter.nb_frames * 1000.0 / elapsed);
+        if (exporter.nb_cells > 0) {
+            fprintf(stderr, "Unchanged cells: %.1f%%\n",
+                    100.0 - exporter.nb_changed * 100.0 / exporter.nb_cells);
+        }
+        if (opts.smooth) fprintf(stderr, "Scene cuts: %ld\n", filter.nb_cuts);
+    }
+    if (first_frame_ms && (!live || opts.fast_start)) {
+        fprintf(stderr, "Time to first frame: %.1f ms\n", first_frame_ms - start_ms);
+    }
+    temporal_filter_free(&filter);
 
     if (ret < 0 && ret != AVERROR_EOF) {
         if (err_context) {
@@ -247,5 +1392,18 @@ end:
 }
 
 void usage() {
-    fprintf(stderr, "Usage: ./main <input>\n");
+    fprintf(stderr, "Usage: ./tvp [options] <input>...\n"
+                    "\n"
+                    "Options:\n"
+                    "  -f <format>  export instead of playing: asciicast, ansi or text\n"
+                    "  -o <path>    export output file (prefix for per-frame text files)\n"
+                    "  -s <WxH>     export grid size (default 80x24)\n"
+                    "  -j <n>       export with n parallel workers, split at keyframes\n"
+                    "  -t           smooth glyphs over time to reduce flicker\n"
+                    "  -c <x,y,w,h> only render this region of the picture, in pixels\n"
+                    "  -F           fast start: probe less and show the first keyframe at once\n"
+                    "\n"
+                    "Several inputs play side by side in a tiled mosaic (q quits).\n"
+                    "\n"
+                    "Keys: arrows or hjkl pan, + and - zoom, 0 shows the full picture\n");
 }